@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "writer/writer.h"
+#include "kernel/kernel.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -52,15 +55,8 @@ int main(int argc, char *argv[]) {
     double start = omp_get_wtime();
 
     #pragma omp parallel for
-    for(int i=0; i<height; i+=2){
-        for(int j=0; j<width; j+=2){
-            int redAvg = (p[channels*(i*width + j)] + p[channels*(i*width + j+1)] + p[channels*((i+1)*width + j)] + p[channels*((i+1)*width + j+1)])/4;
-            int greenAvg = (p[channels*(i*width + j) + 1] + p[channels*(i*width + j+1) + 1] + p[channels*((i+1)*width + j) + 1] + p[channels*((i+1)*width + j+1) + 1])/4;
-            int blueAvg = (p[channels*(i*width + j) + 2] + p[channels*(i*width + j+1) + 2] + p[channels*((i+1)*width + j) + 2] + p[channels*((i+1)*width + j+1) + 2])/4;
-            cpg[channels*((i/2)*comp_width + j/2)] = redAvg;
-            cpg[channels*((i/2)*comp_width + j/2) + 1] = greenAvg;
-            cpg[channels*((i/2)*comp_width + j/2) + 2] = blueAvg;
-        }
+    for(int i=0; i<comp_height; i++){
+        compress_tile(p, cpg, width, channels, i, i+1, 0, comp_width);
     }
 
     double finish = omp_get_wtime();
@@ -68,7 +64,7 @@ int main(int argc, char *argv[]) {
     printf("\nCompression Time: %f seconds\n", elapsed);
     
     
-    stbi_write_jpg(compressedFileName, comp_width, comp_height, channels, comp_img, 100);
+    write_output(compressedFileName, comp_width, comp_height, channels, comp_img);
     printf("Image compression complete\n\n");
 
     //GRAY SCALE
@@ -83,9 +79,7 @@ int main(int argc, char *argv[]) {
 
     #pragma omp parallel for
     for(int i=0; i<comp_height; i++){
-        for(int j=0; j<comp_width; j++){
-            pg[i*comp_width + j] = (uint8_t)((cpg[channels*(i*comp_width + j)] + cpg[channels*(i*comp_width + j) + 1] + cpg[channels*(i*comp_width + j) + 2])/3.0);
-        }
+        grayscale_tile(cpg, pg, comp_width, channels, i, i+1, 0, comp_width);
     }
 
     finish = omp_get_wtime();
@@ -93,7 +87,7 @@ int main(int argc, char *argv[]) {
     printf("Grayscale Time: %f seconds\n", elapsed);
 
 
-    stbi_write_jpg(greyscaleFileName, comp_width, comp_height, gray_channels, gray_img, 100); //1-100 image quality
+    write_output(greyscaleFileName, comp_width, comp_height, gray_channels, gray_img);
     printf("\nImage grayscale complete\n");
 
     /* cleaning up memory*/
@@ -0,0 +1,113 @@
+#include "kernel.h"
+
+#include <stddef.h>
+
+// * per pixel math, channels is a literal at every call site so the loops unroll *
+static inline void average_pixel(const uint8_t *img, uint8_t *cImg, size_t width, size_t cImgWidth, size_t i, size_t j, const int channels)
+{
+  const uint8_t *top = &img[(2 * i * width + 2 * j) * channels];
+  const uint8_t *bottom = top + width * channels;
+  uint8_t *out = &cImg[(i * cImgWidth + j) * channels];
+  for (int ch = 0; ch < channels; ch++)
+  {
+    out[ch] = (top[ch] + top[channels + ch] + bottom[ch] + bottom[channels + ch]) / 4;
+  }
+}
+
+static inline void gray_pixel(const uint8_t *cImg, uint8_t *gImg, size_t cImgWidth, size_t i, size_t j, const int channels)
+{
+  // * only colour channels count, alpha (channel 2 of gray+alpha, 4 of rgba) is ignored *
+  const uint8_t *px = &cImg[(i * cImgWidth + j) * channels];
+  if (channels < 3)
+  {
+    gImg[i * cImgWidth + j] = px[0];
+  }
+  else
+  {
+    gImg[i * cImgWidth + j] = (px[0] + px[1] + px[2]) / 3;
+  }
+}
+
+void compress_tile(const uint8_t *img, uint8_t *cImg, int width, int channels, int cRowStart, int cRowEnd, int cColStart, int cColEnd)
+{
+  size_t cImgWidth = width / 2;
+
+  for (size_t i = cRowStart; i < (size_t)cRowEnd; i++)
+  {
+    for (size_t j = cColStart; j < (size_t)cColEnd; j++)
+    {
+      switch (channels)
+      {
+      case 1:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 1);
+        break;
+      case 2:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 2);
+        break;
+      case 3:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 3);
+        break;
+      case 4:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 4);
+        break;
+      }
+    }
+  }
+}
+
+void grayscale_tile(const uint8_t *cImg, uint8_t *gImg, int cImgWidth, int channels, int cRowStart, int cRowEnd, int cColStart, int cColEnd)
+{
+  for (size_t i = cRowStart; i < (size_t)cRowEnd; i++)
+  {
+    for (size_t j = cColStart; j < (size_t)cColEnd; j++)
+    {
+      switch (channels)
+      {
+      case 1:
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 1);
+        break;
+      case 2:
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 2);
+        break;
+      case 3:
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 3);
+        break;
+      case 4:
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 4);
+        break;
+      }
+    }
+  }
+}
+
+// * fused version for mpi_grayscale, each compressed pixel is grayscaled while it is still in cache *
+void compute_tile(const uint8_t *img, uint8_t *cImg, uint8_t *gImg, int width, int channels, int cRowStart, int cRowEnd, int cColStart, int cColEnd)
+{
+  size_t cImgWidth = width / 2;
+
+  for (size_t i = cRowStart; i < (size_t)cRowEnd; i++)
+  {
+    for (size_t j = cColStart; j < (size_t)cColEnd; j++)
+    {
+      switch (channels)
+      {
+      case 1:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 1);
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 1);
+        break;
+      case 2:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 2);
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 2);
+        break;
+      case 3:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 3);
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 3);
+        break;
+      case 4:
+        average_pixel(img, cImg, width, cImgWidth, i, j, 4);
+        gray_pixel(cImg, gImg, cImgWidth, i, j, 4);
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,13 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stdint.h>
+
+// * The one 2x2 downscale + grayscale kernel shared by grayscale, omp_grayscale and mpi_grayscale *
+// img rows are width pixels wide (odd widths fine, the last column is dropped), cImg/gImg rows are width / 2 wide.
+// Ranges are in compressed pixels: rows [cRowStart, cRowEnd) x columns [cColStart, cColEnd).
+void compress_tile(const uint8_t *img, uint8_t *cImg, int width, int channels, int cRowStart, int cRowEnd, int cColStart, int cColEnd);
+void grayscale_tile(const uint8_t *cImg, uint8_t *gImg, int cImgWidth, int channels, int cRowStart, int cRowEnd, int cColStart, int cColEnd);
+void compute_tile(const uint8_t *img, uint8_t *cImg, uint8_t *gImg, int width, int channels, int cRowStart, int cRowEnd, int cColStart, int cColEnd);
+
+#endif
@@ -1,7 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include "log/log.h"
+#include "writer/writer.h"
+#include "kernel/kernel.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
@@ -12,21 +16,105 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #define BUFFER 100
 #define MANAGER_CORE 0
+#define NUM_SLOTS 2 // double buffering: one slot being computed while the other is decoded/encoded
+#define MIN_ROWS_PER_RANK 64 // below this many compressed rows a rank costs more in barriers than it saves
 
 #define __DEBUG__ 1
 
-int main(int argc, char *argv[])
+// * One source image and its two destinations *
+typedef struct
+{
+  int argIndex; // argv index of the source, the compressed/grayscale dests follow it
+  int readWidth, readHeight, channels;
+  output_params_t cParams, gParams;
+} image_job_t;
+
+// * Decode stage: load, crop to even dimensions and copy into the shared window *
+static int decode_image(const char *fileName, const image_job_t *job, uint8_t *img)
+{
+  int readWidth, readHeight, readChannels;
+  uint8_t *readImg = stbi_load(fileName, &readWidth, &readHeight, &readChannels, job->channels);
+  if (readImg == NULL || readWidth != job->readWidth || readHeight != job->readHeight)
+  {
+    stbi_image_free(readImg);
+    return 0;
+  }
+
+  int channels = job->channels;
+  int height = (readHeight / 2) * 2;
+  int width = (readWidth / 2) * 2;
+  for (int i = 0; i < height; i++)
+  {
+    memcpy(&img[(size_t)i * width * channels], &readImg[(size_t)i * readWidth * channels], (size_t)width * channels);
+  }
+  stbi_image_free(readImg);
+  return 1;
+}
+
+// * Split n units into parts as evenly as possible, the first n % parts get one extra *
+static void partition(int n, int parts, int idx, int *start, int *end)
+{
+  int mod = n % parts;
+  int div = n / parts;
+  *start = (idx >= mod) ? (mod * (div + 1) + (idx - mod) * div) : idx * (div + 1);
+  *end = *start + ((idx >= mod) ? div : div + 1);
+}
+
+// * Tile grid for one image: bands at least minRows tall, with tiles also at least minRows wide *
+// never more tiles than nWorkers, surplus workers idle
+static void tile_grid(const image_job_t *job, int minRows, int useTiles, int nWorkers, int *tilesY, int *tilesX)
 {
-  typedef enum filetype
+  int cImgHeight = job->readHeight / 2;
+  int cImgWidth = job->readWidth / 2;
+
+  *tilesY = cImgHeight / minRows;
+  *tilesY = (*tilesY < 1) ? 1 : (*tilesY > nWorkers) ? nWorkers : *tilesY;
+  *tilesX = 1;
+  if (useTiles)
   {
-    PNG,
-    JPG,
-    BMP
-  } filetype_t;
+    *tilesX = cImgWidth / minRows;
+    *tilesX = (*tilesX < 1) ? 1 : (*tilesX > nWorkers / *tilesY) ? nWorkers / *tilesY : *tilesX;
+  }
+}
 
+// * Encode stage: write both outputs and report *
+static void encode_image(char *argv[], const image_job_t *job, const uint8_t *cImg, const uint8_t *gImg, double elapsed)
+{
+  char *originalFileName = argv[job->argIndex];
+  char *compressedFileName = argv[job->argIndex + 1];
+  char *grayscaleFileName = argv[job->argIndex + 2];
+  int cImgWidth = job->readWidth / 2;
+  int cImgHeight = job->readHeight / 2;
+  struct stat preCompSb;
+  write_stats_t cStats = {0}, gStats = {0};
+
+  if (!write_image(compressedFileName, cImgWidth, cImgHeight, job->channels, cImg, job->cParams, &cStats))
+  {
+    fprintf(stderr, "Error writing %s\n", compressedFileName);
+#if __DEBUG__ == 1
+    log_error("Error writing compressed image - Filename: %s", compressedFileName);
+#endif
+  }
+  if (!write_image(grayscaleFileName, cImgWidth, cImgHeight, 1, gImg, job->gParams, &gStats))
+  {
+    fprintf(stderr, "Error writing %s\n", grayscaleFileName);
+#if __DEBUG__ == 1
+    log_error("Error writing grayscale image - Filename: %s", grayscaleFileName);
+#endif
+  }
+  stat(originalFileName, &preCompSb);
+  printf("Filename: %s\nPre-compression size: %ld B\nPost-compression size: %zu B\nTime: %f\n",originalFileName, preCompSb.st_size, gStats.bytes, elapsed);
+  write_stats_print(stdout, "Compressed", compressedFileName, job->cParams, &cStats);
+  write_stats_print(stdout, "Grayscale", grayscaleFileName, job->gParams, &gStats);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
 #if __DEBUG__ == 1
   FILE *logFile = fopen("log.txt", "w");
   log_add_fp(logFile, LOG_TRACE);
@@ -34,15 +122,14 @@ int main(int argc, char *argv[])
 #endif
 
   // * Variables *
-  double start, elapsed;
+  double start, elapsed, pipelineStart;
   int nproc, rank;
-  int width, height, channels;
-  int readHeight, readWidth;
-  char *originalFileName, *compressedFileName, *grayscaleFileName;
-  struct stat preCompSb, postCompSb;
+  int nImages = 0;
+  int minRows = MIN_ROWS_PER_RANK, useTiles = 0;
+  output_params_t cParams = {UNKNOWN_FILETYPE, -1}, gParams = {UNKNOWN_FILETYPE, -1};
+  image_job_t *jobs = NULL;
 
-  uint8_t *readImg, *img, *cImg, *gImg;
-  filetype_t ftype;
+  uint8_t *img[NUM_SLOTS], *cImg[NUM_SLOTS], *gImg[NUM_SLOTS];
 
   MPI_Init(&argc, &argv); /* Intialize MPI*/
   MPI_Comm comm = MPI_COMM_WORLD;
@@ -55,247 +142,286 @@ int main(int argc, char *argv[])
 
   if (rank == 0)
   {
-    if (argc < 4)
-    {
-      fprintf(stderr, "Usage mpiexec -n <# of processes> ./mpi_grayscale <image_file> <compressed_image_dest> <greyscale_image_dest>\n");
-      exit(EXIT_FAILURE);
-    }
-    else
+    // * -c/-g take a preset name or <format>[:<quality>] for the compressed/grayscale output *
+    // * -m sets the minimum compressed rows (and, with -t, columns) a rank gets, -t splits columns too *
+    // '+' stops at the first positional: GNU getopt would otherwise permute argv on rank 0 only,
+    // and the encode rank indexes its own untouched argv with the job's argIndex
+    int opt;
+    while ((opt = getopt(argc, argv, "+c:g:m:t")) != -1)
     {
-      originalFileName = argv[1];
-      compressedFileName = argv[2];
-      grayscaleFileName = argv[3];
-    }
-    char *dot = strrchr(originalFileName, '.');
-    if (strcmp(dot, ".png") == 0)
-    {
-      ftype = PNG;
-    }
-    else if (strcmp(dot, ".jpg") == 0)
-    {
-      ftype = JPG;
-    }
-    else if (strcmp(dot, ".bmp") == 0)
-    {
-      ftype = BMP;
+      if (opt == 'm')
+      {
+        char *end;
+        long rows = strtol(optarg, &end, 10);
+        if (*end == '\0' && end != optarg && rows > 0 && rows <= INT_MAX)
+        {
+          minRows = (int)rows;
+          continue;
+        }
+      }
+      else if (opt == 't')
+      {
+        useTiles = 1;
+        continue;
+      }
+      output_params_t *params = (opt == 'c') ? &cParams : (opt == 'g') ? &gParams : NULL;
+      if (params == NULL || output_params_parse(optarg, params) != 0)
+      {
+        if (params != NULL)
+        {
+          fprintf(stderr, "Bad output spec '%s' for -%c\n", optarg, opt);
+        }
+        else if (opt == 'm')
+        {
+          fprintf(stderr, "-m needs a positive number of rows\n");
+        }
+        output_presets_print(stderr);
+        MPI_Abort(comm, EXIT_FAILURE);
+        return EXIT_FAILURE;
+      }
     }
 
-    // *** TODO: Handle odd dimensions
-    // *** TODO: Handle dimensions that don't play nicely with nproc and comp_value values
-    stat(originalFileName, &preCompSb);
-    readImg = stbi_load(originalFileName, &readWidth, &readHeight, &channels, 0);
-    printf("\n\nLoaded image with a width of %dpx, a height of %dpx and %d channels\n", readWidth, readHeight, channels);
-    printf("Number procs: %d\n", nproc);
-
-    height = (readHeight/2)*2;
-    width = (readWidth/2)*2;
-
-
-
-
-    if (readImg == NULL)
+    if (argc - optind < 3 || (argc - optind) % 3 != 0)
     {
-      printf("Error reading image, exiting...");
-#if __DEBUG__ == 1
-      log_error("Error reading image - Filename: %s", originalFileName);
-#endif
+      fprintf(stderr, "Usage mpiexec -n <# of processes> ./mpi_grayscale [-c <spec>] [-g <spec>] [-m <min rows per rank>] [-t] <image_file> <compressed_image_dest> <greyscale_image_dest> [<image_file> <compressed_image_dest> <greyscale_image_dest> ...]\n");
+      fprintf(stderr, "  <spec> is a preset or <jpg|png|bmp|pnm>[:<quality>], default is the destination's extension at full quality\n");
+      output_presets_print(stderr);
       MPI_Abort(comm, EXIT_FAILURE);
       return EXIT_FAILURE;
     }
 
+    // * Read every header up front so the windows can be sized once for the largest image *
+    jobs = malloc(((argc - optind) / 3) * sizeof(image_job_t));
+    for (int a = optind; a < argc; a += 3)
+    {
+      image_job_t *job = &jobs[nImages];
+      char *originalFileName = argv[a];
+      job->argIndex = a;
 
-
-
+      if (!stbi_info(originalFileName, &job->readWidth, &job->readHeight, &job->channels))
+      {
+        printf("Error reading image %s, skipping...\n", originalFileName);
 #if __DEBUG__ == 1
-    log_trace("rank 0 - immediately after reading image - height: %d, width: %d, channels: %d\n", height, width, channels);
+        log_error("Error reading image header - Filename: %s", originalFileName);
 #endif
-  }
-
-
-
-
-
+        continue;
+      }
 
-  // * Wait for 0 to finish reading and allocating memory *
-  MPI_Barrier(comm);
+      // * no explicit spec -> destination extension, falling back on the input's extension *
+      filetype_t inType = filetype_from_name(originalFileName);
+      job->cParams = cParams;
+      job->gParams = gParams;
+      if (job->cParams.ftype == UNKNOWN_FILETYPE)
+      {
+        job->cParams.ftype = filetype_from_name(argv[a + 1]);
+        job->cParams.ftype = (job->cParams.ftype == UNKNOWN_FILETYPE) ? inType : job->cParams.ftype;
+      }
+      if (job->gParams.ftype == UNKNOWN_FILETYPE)
+      {
+        job->gParams.ftype = filetype_from_name(argv[a + 2]);
+        job->gParams.ftype = (job->gParams.ftype == UNKNOWN_FILETYPE) ? inType : job->gParams.ftype;
+      }
+      if (job->cParams.ftype == UNKNOWN_FILETYPE || job->gParams.ftype == UNKNOWN_FILETYPE)
+      {
+        printf("Could not work out an output format for %s, pass -c/-g or use a known extension, skipping...\n", originalFileName);
+        continue;
+      }
+      nImages++;
+    }
+    printf("Number procs: %d\nNumber images: %d\n", nproc, nImages);
+  }
 
-  // * Broadcast metadata *
-  MPI_Bcast(&readHeight, 1, MPI_INT, 0, comm);
-  MPI_Bcast(&readWidth, 1, MPI_INT, 0, comm);
-  MPI_Bcast(&width, 1, MPI_INT, 0, comm); // shouldn't hurt perf even though it's message passing since it's such little data
-  MPI_Bcast(&height, 1, MPI_INT, 0, comm);
-  MPI_Bcast(&channels, 1, MPI_INT, 0, comm);
-  MPI_Barrier(comm);
+  // * Broadcast the job list, argv is the same on every rank so indices into it are enough *
+  MPI_Bcast(&nImages, 1, MPI_INT, 0, comm);
+  MPI_Bcast(&minRows, 1, MPI_INT, 0, comm);
+  MPI_Bcast(&useTiles, 1, MPI_INT, 0, comm);
+  if (nImages == 0)
+  {
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  if (rank != 0)
+  {
+    jobs = malloc(nImages * sizeof(image_job_t));
+  }
+  MPI_Bcast(jobs, nImages * sizeof(image_job_t), MPI_BYTE, 0, comm);
 
-  // * Declare windows
-  MPI_Win imgWindow, cImgWindow, gImgWindow;
+  // * Drop ranks no image has work for *
+  // every rank that stays joins the per-step barrier, so surplus ranks leave here instead of
+  // idling through it. Multi-image runs keep two extra ranks for decode/encode.
+  int wantWorkers = 1;
+  for (int k = 0; k < nImages; k++)
+  {
+    int tilesY, tilesX;
+    tile_grid(&jobs[k], minRows, useTiles, INT_MAX, &tilesY, &tilesX);
+    wantWorkers = (tilesY * tilesX > wantWorkers) ? tilesY * tilesX : wantWorkers;
+  }
+  int wantRanks = wantWorkers + ((nImages > 1) ? 2 : 0);
+  int worldProcs = nproc;
+  MPI_Comm_split(MPI_COMM_WORLD, (rank < wantRanks) ? 0 : MPI_UNDEFINED, rank, &comm);
+  if (comm == MPI_COMM_NULL)
+  {
+    free(jobs);
+    MPI_Finalize();
+    return 0;
+  }
+  MPI_Comm_size(comm, &nproc);
+  if (rank == 0)
+  {
+    printf("Active ranks: %d of %d\n", nproc, worldProcs);
+  }
 
-  // * size calculations
+  // * size calculations, done once for the biggest image *
   int disp_unit = sizeof(uint8_t); // will need to make this dyanmic if we decide to take non-8-bit colors
-  int imgSize = width * height * channels, cImgSize = imgSize / 4, gImgSize = imgSize / (channels * 4);
-  MPI_Aint aintImg, aintCImg, aintGImg;
-  // TODOS: Need to handle case where images have an odd*odd, odd*(evenNotDivisibleBy4) where left over pixels will result from calculation and
-  // TODOS: as such will screw with size calculations as well.
+  MPI_Aint imgSize = 0, cImgSize = 0, gImgSize = 0;
+  for (int k = 0; k < nImages; k++)
+  {
+    MPI_Aint width = jobs[k].readWidth / 2, height = jobs[k].readHeight / 2;
+    imgSize = (4 * width * height * jobs[k].channels > imgSize) ? 4 * width * height * jobs[k].channels : imgSize;
+    cImgSize = (width * height * jobs[k].channels > cImgSize) ? width * height * jobs[k].channels : cImgSize;
+    gImgSize = (width * height > gImgSize) ? width * height : gImgSize;
+  }
 
-  // * create windows *
+  // * create windows, one per image up to NUM_SLOTS so stages can run on different images *
+  int nSlots = (nImages < NUM_SLOTS) ? nImages : NUM_SLOTS;
+  MPI_Win imgWindow[NUM_SLOTS], cImgWindow[NUM_SLOTS], gImgWindow[NUM_SLOTS];
+  MPI_Aint aintImg, aintCImg, aintGImg;
+  for (int s = 0; s < nSlots; s++)
+  {
+    MPI_Win_allocate_shared((rank == 0) ? imgSize : 0, disp_unit, MPI_INFO_NULL, comm, &img[s], &imgWindow[s]);
+    MPI_Win_allocate_shared((rank == 0) ? cImgSize : 0, disp_unit, MPI_INFO_NULL, comm, &cImg[s], &cImgWindow[s]);
+    MPI_Win_allocate_shared((rank == 0) ? gImgSize : 0, disp_unit, MPI_INFO_NULL, comm, &gImg[s], &gImgWindow[s]);
+  }
 
-  MPI_Win_allocate_shared((rank == 0) ? imgSize : 0, disp_unit, MPI_INFO_NULL, comm, &img, &imgWindow);
-  MPI_Win_allocate_shared((rank == 0) ? cImgSize : 0, disp_unit, MPI_INFO_NULL, comm, &cImg, &cImgWindow);
-  MPI_Win_allocate_shared((rank == 0) ? gImgSize : 0, disp_unit, MPI_INFO_NULL, comm, &gImg, &gImgWindow);
-  
   MPI_Barrier(comm);
   if (rank != 0)
   {
-    MPI_Win_shared_query(imgWindow, 0, &aintImg, &disp_unit, &img);
-    MPI_Win_shared_query(cImgWindow, 0, &aintCImg, &disp_unit, &cImg);
-    MPI_Win_shared_query(gImgWindow, 0, &aintGImg, &disp_unit, &gImg);
+    for (int s = 0; s < nSlots; s++)
+    {
+      MPI_Win_shared_query(imgWindow[s], 0, &aintImg, &disp_unit, &img[s]);
+      MPI_Win_shared_query(cImgWindow[s], 0, &aintCImg, &disp_unit, &cImg[s]);
+      MPI_Win_shared_query(gImgWindow[s], 0, &aintGImg, &disp_unit, &gImg[s]);
+    }
   }
+#if __DEBUG__ == 1
+  log_trace("rank %d - %d slots of imgSize: %ld bytes\tcImgSize %ld bytes\tgImgSize: %ld bytes", rank, nSlots, (long)imgSize, (long)cImgSize, (long)gImgSize);
+#endif
+
+  // * Three stage pipeline *
+  // step t: rank 0 decodes image t, the encode rank writes image t-2 and whoever has no I/O
+  // this step computes image t-1. Image k lives in slot k % nSlots for its whole life.
+  int decodeRank = 0;
+  int encodeRank = (nproc > 2) ? nproc - 1 : 0;
+  int *decoded = calloc(nImages, sizeof(int));
+  double *computeTimes = calloc(nImages, sizeof(double));
+  double idle = 0, maxIdle, sumIdle;
 
   MPI_Barrier(comm);
+  pipelineStart = MPI_Wtime();
 
-  if (rank == 0)
+  for (int t = 0; t < nImages + 2; t++)
   {
+    int dk = t, ck = t - 1, ek = t - 2;
+    int decodeActive = dk < nImages;
+    int computeActive = ck >= 0 && ck < nImages && decoded[ck];
+    int encodeActive = ek >= 0 && decoded[ek];
 
-    for(int i = 0; i<height; i++){
-      for(int j = 0; j<width; j++){
-        for(int k = 0; k<channels; k++){
-          img[i*width*channels + j*channels + k] = readImg[i*readWidth*channels + j*channels + k];
-        }
+    if (rank == decodeRank && decodeActive)
+    {
+      image_job_t *job = &jobs[dk];
+      decoded[dk] = decode_image(argv[job->argIndex], job, img[dk % nSlots]);
+      if (decoded[dk])
+      {
+        printf("\n\nLoaded image with a width of %dpx, a height of %dpx and %d channels\n", job->readWidth, job->readHeight, job->channels);
       }
-    }
-    free(readImg);
-
+      else
+      {
+        printf("Error reading image %s, skipping...\n", argv[job->argIndex]);
 #if __DEBUG__ == 1
-    log_trace("imgSize: %d bytes\tcImgSize %d bytes\tgImgSize: %d bytes", imgSize, cImgSize, gImgSize);
+        log_error("Error reading image - Filename: %s", argv[job->argIndex]);
 #endif
-  }
-  
-  MPI_Barrier(comm);
-
-  int hmod = height % nproc;
-  int hdiv = height / nproc;
-  int work_height_start = (rank >= hmod) ? ((hmod) * (hdiv + 1) + (rank - hmod) * hdiv) : rank * (hdiv + 1);
-  int work_height_end = work_height_start + ((rank >= hmod) ? hdiv : hdiv + 1);
-
-  int cImgWidth = width/2;
-  int cImgHeight = height/2;
-
-  uint32_t *ch_temp = calloc(channels, sizeof(uint32_t));
-
-  int index = 0;
-
-  
-  
-  MPI_Barrier(comm);
-  start = MPI_Wtime();
-
-  // for (int i = work_height_start/comp_value; i < work_height_end/comp_value; i++)
-  // { // height where work is being done at in incremenets of comp_value
-  //   for (int j = 0; j < width/comp_value; j++)
-  //   { // width where work is being done at in increments of comp_value
-  //     for (int k = 0; k < comp_value; k++)
-  //     { // iterate over y axis of comp_value
-  //       for (int a = 0; a < comp_value; a++)
-  //       { // iterate over x axis of comp_value
-  //         for (int ch = 0; ch < channels; ch++)
-  //         { // iterate over each channel
-  //           index = i * comp_value * width * channels + j*comp_value*channels + k*width*channels + a*channels + ch;
-  //           ch_temp[ch] += img[index];
-  //         }
-  //       }
-  //     }
-  //     for (int ch = 0; ch < channels; ch++)
-  //     {
-  //       cImg[(i*(width/comp_value) + j)*channels + ch] = (uint8_t)(ch_temp[ch] / comp_value_block);
-  //       ch_temp[ch] = 0;
-  //     }
-  //   }
-  // }
-
-  if(channels == 3){
-    for (int i = work_height_start/2; i < work_height_end/2; i++)
-    { // height where work is being done at in incremenets of comp_value
-      for (int j = 0; j < width/2; j++)
-      { // width where work is being done at in increments of comp_value
-        cImg[(i*(cImgWidth) + j)*channels] = (img[2*channels*((i*width) + j)] + img[2*channels*((i*width) + j + 1)] + img[2*channels*(((i+1)*width) + j)] + img[2*channels*(((i+1)*width) + (j+1))])/4; 
-        cImg[(i*(cImgWidth) + j)*channels + 1] = (img[2*channels*((i*width) + j) + 1] + img[2*channels*((i*width) + j + 1) + 1] + img[2*channels*(((i+1)*width) + j) + 1] + img[2*channels*(((i+1)*width) + (j+1)) + 1])/4; 
-        cImg[(i*(cImgWidth) + j)*channels + 2] = (img[2*channels*((i*width) + j) + 2] + img[2*channels*((i*width) + j + 1) + 2] + img[2*channels*(((i+1)*width) + j) + 2] + img[2*channels*(((i+1)*width) + (j+1)) + 2])/4;
       }
+      fflush(stdout);
     }
-  } else if (channels == 2){
-    for (int i = work_height_start/2; i < work_height_end/2; i++)
-    { // height where work is being done at in incremenets of comp_value
-      for (int j = 0; j < width/2; j++)
-      { // width where work is being done at in increments of comp_value
-        cImg[(i*(cImgWidth) + j)*channels] = (img[2*channels*((i*width) + j)] + img[2*channels*((i*width) + j + 1)] + img[2*channels*(((i+1)*width) + j)] + img[2*channels*(((i+1)*width) + (j+1))])/4; 
-        cImg[(i*(cImgWidth) + j)*channels + 1] = (img[2*channels*((i*width) + j) + 1] + img[2*channels*((i*width) + j + 1) + 1] + img[2*channels*(((i+1)*width) + j) + 1] + img[2*channels*(((i+1)*width) + (j+1)) + 1])/4; 
-      }
+    if (rank == encodeRank && encodeActive)
+    {
+      encode_image(argv, &jobs[ek], cImg[ek % nSlots], gImg[ek % nSlots], computeTimes[ek]);
     }
-  }
-  else if (channels == 1){
-  for (int i = work_height_start/2; i < work_height_end/2; i++)
-    { // height where work is being done at in incremenets of comp_value
-    for (int j = 0; j < width/2; j++)
-      { // width where work is being done at in increments of comp_value
-        cImg[(i*(cImgWidth) + j)*channels] = (img[2*channels*((i*width) + j)] + img[2*channels*((i*width) + j + 1)] + img[2*channels*(((i+1)*width) + j)] + img[2*channels*(((i+1)*width) + (j+1))])/4; 
-      }
+
+    // * ranks busy with I/O sit this step out unless nobody else is left *
+    int decodeBusy = decodeActive;
+    int encodeBusy = encodeActive && encodeRank != decodeRank;
+    int busy0 = decodeBusy || (encodeActive && encodeRank == decodeRank);
+    int nWorkers = nproc - busy0 - encodeBusy;
+    int worker = rank - busy0;
+    if (nWorkers <= 0)
+    {
+      nWorkers = 1;
+      worker = rank;
+    }
+    else if ((rank == decodeRank && busy0) || (rank == encodeRank && encodeBusy))
+    {
+      worker = -1;
     }
-  }
-  
 
+    elapsed = 0;
+    if (computeActive && worker >= 0)
+    {
+      image_job_t *job = &jobs[ck];
+      int cImgHeight = job->readHeight / 2;
+      int cImgWidth = job->readWidth / 2;
 
-  hmod = cImgHeight % nproc;
-  hdiv = cImgHeight / nproc;
-  work_height_start /= 2;
-  work_height_end /= 2;
+      // * partition in compressed pixels so no band boundary lands mid 2x2 block *
+      // images smaller than the biggest one can still leave some workers idle this step
+      int tilesY, tilesX;
+      tile_grid(job, minRows, useTiles, nWorkers, &tilesY, &tilesX);
 
-  for (int i = work_height_start; i < work_height_end; i++)
-  {
-    for (int j = 0; j < cImgWidth; j++)
-    {
-      int sum = 0;
-      for (int ch = 0; ch < channels; ch++)
+      if (worker < tilesY * tilesX)
       {
-        sum += cImg[(i * cImgWidth + j) * channels + ch];
+        int cRowStart, cRowEnd, cColStart, cColEnd;
+        partition(cImgHeight, tilesY, worker / tilesX, &cRowStart, &cRowEnd);
+        partition(cImgWidth, tilesX, worker % tilesX, &cColStart, &cColEnd);
+
+        start = MPI_Wtime();
+        compute_tile(img[ck % nSlots], cImg[ck % nSlots], gImg[ck % nSlots], cImgWidth * 2, job->channels, cRowStart, cRowEnd, cColStart, cColEnd);
+        elapsed = MPI_Wtime() - start;
       }
-      gImg[i * cImgWidth + j] = sum / channels;
     }
-  }
-  MPI_Barrier(comm);
-  elapsed = MPI_Wtime() - start;
-  
-
-
 
+    start = MPI_Wtime();
+    MPI_Barrier(comm);
+    idle += MPI_Wtime() - start;
 
-  // write resulting images
-  if (rank == 0)
-  {
-
-    
-   
-    if (ftype == PNG)
+    // * everyone needs to know whether image t made it before computing/encoding it *
+    if (decodeActive)
     {
-      stbi_write_png(compressedFileName, cImgWidth, cImgHeight, channels, cImg, 0);
-      stbi_write_png(grayscaleFileName, cImgWidth, cImgHeight, 1, gImg, 0);
+      MPI_Bcast(&decoded[dk], 1, MPI_INT, decodeRank, comm);
     }
-    else if (ftype == JPG)
+    if (computeActive)
     {
-      stbi_write_jpg(compressedFileName, cImgWidth, cImgHeight, channels, cImg, 100);
-      stbi_write_jpg(grayscaleFileName, cImgWidth, cImgHeight, 1, gImg, 100);
+      MPI_Reduce(&elapsed, &computeTimes[ck], 1, MPI_DOUBLE, MPI_MAX, encodeRank, comm);
     }
-    else if (ftype == BMP)
-    {
-      stbi_write_bmp(compressedFileName, cImgWidth, cImgHeight, channels, cImg);
-      stbi_write_bmp(grayscaleFileName, cImgWidth, cImgHeight, 1, gImg);
-    }
-    stat(grayscaleFileName, &postCompSb);
-    printf("Filename: %s\nPre-compression size: %ld B\nPost-compression size: %ld B\nTime: %f\n",originalFileName, preCompSb.st_size, postCompSb.st_size, elapsed);
   }
-  MPI_Win_free(&imgWindow);
-  MPI_Win_free(&cImgWindow);
-  MPI_Win_free(&gImgWindow);
+
+  elapsed = MPI_Wtime() - pipelineStart;
+  MPI_Reduce(&idle, &maxIdle, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+  MPI_Reduce(&idle, &sumIdle, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+  if (rank == 0)
+  {
+    printf("\nPipeline: %d images in %f s (%f images/s)\nBarrier idle: max %f s, avg %f s per rank\n", nImages, elapsed, nImages / elapsed, maxIdle, sumIdle / nproc);
+  }
+
+  for (int s = 0; s < nSlots; s++)
+  {
+    MPI_Win_free(&imgWindow[s]);
+    MPI_Win_free(&cImgWindow[s]);
+    MPI_Win_free(&gImgWindow[s]);
+  }
+  MPI_Comm_free(&comm);
+  free(decoded);
+  free(computeTimes);
+  free(jobs);
   MPI_Finalize();
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../stb/stb_image_write.h"
+
+// * Deterministic synthetic test images *
+// Every pixel is a hash of (seed, x, y, channel), so any size can be regenerated bit for bit
+// without storing it. 1 and 3 channel images are streamed out one row at a time as raw
+// PGM/PPM, which keeps gigapixel inputs cheap. stb only reads 2/4 channel data from PNG,
+// so those are built in memory and written with stbi_write_png.
+
+static uint8_t pixel(uint32_t seed, uint32_t x, uint32_t y, uint32_t c)
+{
+  uint32_t h = seed * 0x9E3779B1u ^ x * 0x85EBCA77u ^ y * 0xC2B2AE3Du ^ c * 0x27D4EB2Fu;
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  h *= 0x297A2D39u;
+  h ^= h >> 15;
+  return (uint8_t)h;
+}
+
+static void fill_row(uint8_t *row, uint32_t seed, int width, int y, int channels)
+{
+  for (int x = 0; x < width; x++)
+  {
+    for (int c = 0; c < channels; c++)
+    {
+      row[(size_t)x * channels + c] = pixel(seed, x, y, c);
+    }
+  }
+}
+
+static int write_raw(const char *fileName, int width, int height, int channels, uint32_t seed)
+{
+  FILE *fp = fopen(fileName, "wb");
+  if (fp == NULL)
+  {
+    return 0;
+  }
+  size_t rowSize = (size_t)width * channels;
+  uint8_t *row = malloc(rowSize);
+  int ok = fprintf(fp, "P%c\n%d %d\n255\n", (channels == 1) ? '5' : '6', width, height) > 0;
+  for (int y = 0; ok && y < height; y++)
+  {
+    fill_row(row, seed, width, y, channels);
+    ok = fwrite(row, 1, rowSize, fp) == rowSize;
+  }
+  free(row);
+  return (fclose(fp) == 0) && ok;
+}
+
+static int write_png(const char *fileName, int width, int height, int channels, uint32_t seed)
+{
+  size_t rowSize = (size_t)width * channels;
+  uint8_t *img = malloc(rowSize * height);
+  if (img == NULL)
+  {
+    return 0;
+  }
+  for (int y = 0; y < height; y++)
+  {
+    fill_row(&img[rowSize * y], seed, width, y, channels);
+  }
+  int ok = stbi_write_png(fileName, width, height, channels, img, 0);
+  free(img);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 6)
+  {
+    fprintf(stderr, "Usage ./gen_image <width> <height> <channels 1-4> <seed> <dest>\n");
+    fprintf(stderr, "  1/3 channels are written as raw pgm/ppm, 2/4 channels as png\n");
+    return EXIT_FAILURE;
+  }
+  int width = atoi(argv[1]);
+  int height = atoi(argv[2]);
+  int channels = atoi(argv[3]);
+  uint32_t seed = (uint32_t)strtoul(argv[4], NULL, 10);
+  char *fileName = argv[5];
+
+  if (width < 2 || height < 2 || channels < 1 || channels > 4)
+  {
+    fprintf(stderr, "Need width, height >= 2 and 1-4 channels\n");
+    return EXIT_FAILURE;
+  }
+
+  int ok = (channels == 1 || channels == 3) ? write_raw(fileName, width, height, channels, seed) : write_png(fileName, width, height, channels, seed);
+  if (!ok)
+  {
+    fprintf(stderr, "Error writing %s\n", fileName);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+#!/bin/bash
+# Throughput regression check: per image size, best-of-N MB/s for each stage, compared with
+# tests/perf_baseline.txt. Exits non-zero when any stage drops more than PERF_THRESHOLD percent.
+# Each sample repeats a binary (or, for mpi_grayscale, the image inside one pipelined run) until
+# its quickest stage adds up to PERF_MIN_SECONDS, so small images are not timed off single runs.
+# All inputs are on disk at once while timing, about 1.1 GiB more with PERF_LARGE.
+#
+#   PERF_SIZES        space separated WIDTHxHEIGHTxCHANNELS list (default below)
+#   PERF_LARGE        =1 also runs a 32768x32768 (1.07 gigapixel) raw grayscale image
+#   PERF_REPS         samples per stage, the fastest one counts (default 5)
+#   PERF_MIN_SECONDS  least time the quickest stage of a sample adds up to (default 0.05)
+#   PERF_MAX_INNER    cap on the repetitions inside one sample (default 200)
+#   PERF_THREADS      OpenMP threads, PERF_PROCS MPI ranks (default: the baseline's, else nproc)
+#   PERF_THRESHOLD    allowed slowdown in percent (default 25)
+#   MPIEXEC           launcher (default mpiexec), MPIEXEC_FLAGS extra launcher flags
+#   UPDATE_BASELINE   =1 rewrites perf_baseline.txt with this machine's numbers
+#
+# The baseline is machine specific and not tracked, the first run on a machine writes it.
+
+
+
+testDir=$(cd "$(dirname "$0")" && pwd)
+rootDir=$(dirname "$testDir")
+outDir="$testDir/out/perf"
+baselineFile="$testDir/perf_baseline.txt"
+
+# * threads/ranks come from the baseline's config line so the numbers describe the same run *
+baseThreads="" baseProcs=""
+if [ -f "$baselineFile" ]; then
+  read -r baseThreads baseProcs < <(awk '$1 == "#" && $2 == "config" { for (i = 3; i <= NF; i++) { split($i, kv, "="); v[kv[1]] = kv[2] } print v["threads"], v["ranks"]; exit }' "$baselineFile")
+fi
+
+sizes=(${PERF_SIZES:-1024x768x3 2048x1536x3 4096x3072x3 4099x3071x1 8192x6144x1})
+if [ "${PERF_LARGE:-0}" = "1" ]; then
+  sizes+=(32768x32768x1)
+fi
+reps=${PERF_REPS:-5}
+minSeconds=${PERF_MIN_SECONDS:-0.05}
+maxInner=${PERF_MAX_INNER:-200}
+threads=${PERF_THREADS:-${baseThreads:-$(nproc)}}
+procs=${PERF_PROCS:-${baseProcs:-$(nproc)}}
+threshold=${PERF_THRESHOLD:-25}
+mpiexec=${MPIEXEC:-mpiexec}
+read -r -a mpiFlags <<< "${MPIEXEC_FLAGS:-}"
+
+rm -rf "$outDir"
+mkdir -p "$outDir"
+cd "$outDir" || exit 1
+
+results="$outDir/results.txt"
+: > "$results"
+
+# * one run of each binary, prints its stage times in seconds *
+run_serial() { # <input>
+  "$rootDir/grayscale" 1 "$1" out_c.pnm out_g.pnm |
+    awk '/^Compression Time:/ { c = $3 } /^Grayscale Time:/ { g = $3 } END { if (c != "" && g != "") print c, g }'
+}
+
+run_omp() { # <input>
+  "$rootDir/omp_grayscale" "$threads" "$1" out_c.pnm out_g.pnm |
+    awk '/^Compression Time:/ { c = $3 } /Total Time:/ { t = $5 } END { if (c != "" && t != "") print c, t }'
+}
+
+# the image <count> times through one pipelined mpi_grayscale run, prints compute and encode sums
+run_mpi() { # <input> <count>
+  local jobs=()
+  for k in $(seq 1 "$2"); do
+    jobs+=("$1" out_c.pnm out_g.pnm)
+  done
+  "$mpiexec" "${mpiFlags[@]}" -n "$procs" "$rootDir/mpi_grayscale" -c raw -g raw "${jobs[@]}" |
+    awk -v n="$2" '/^Time:/ { t += $2; tn++ } /^Compressed:/ { e += $(NF - 3); en++ } END { if (tn == n && en == n) printf "%.9f %.9f\n", t, e }'
+}
+
+# <count> runs of a run_serial/run_omp style command, prints the per column sums
+sum_runs() { # <count> <command...>
+  local count=$1
+  shift
+  for k in $(seq 1 "$count"); do
+    "$@"
+  done | awk -v n="$count" '{ for (i = 1; i <= NF; i++) s[i] += $i } END { if (NR == n) { for (i = 1; i <= NF; i++) printf "%.9f ", s[i]; print "" } }'
+}
+
+# repetitions needed for the quickest of <seconds...> to add up to minSeconds
+inner_count() { # <seconds...>
+  printf '%s\n' "$@" | sort -g | head -1 |
+    awk -v want="$minSeconds" -v cap="$maxInner" '{ n = ($1 > 0) ? int(want / $1) + 1 : cap; print (n > cap) ? cap : n }'
+}
+
+# best (lowest) seconds of a list -> MB/s for <bytes>
+best_mbps() { # <bytes> <seconds...>
+  local bytes=$1
+  shift
+  printf '%s\n' "$@" | sort -g | head -1 | awk -v b="$bytes" '{ printf "%.2f", ($1 > 0) ? b / 1048576 / $1 : 0 }'
+}
+
+# * generate every input and size the samples before timing anything *
+declare -A inputs inner samples
+for size in "${sizes[@]}"; do
+  IFS=x read -r width height channels <<< "$size"
+  case $channels in
+    1) input="in_$size.pgm" ;;
+    3) input="in_$size.ppm" ;;
+    *) input="in_$size.png" ;;
+  esac
+  "$testDir/gen_image" "$width" "$height" "$channels" 1 "$input" || exit 1
+  inputs[$size]=$input
+
+  read -r -a t <<< "$(run_serial "$input")"
+  [ ${#t[@]} -eq 2 ] || { echo "grayscale failed on $input"; exit 1; }
+  inner[$size serial]=$(inner_count "${t[@]}")
+  read -r -a t <<< "$(run_omp "$input")"
+  [ ${#t[@]} -eq 2 ] || { echo "omp_grayscale failed on $input"; exit 1; }
+  inner[$size omp]=$(inner_count "${t[@]}")
+  read -r -a t <<< "$(run_mpi "$input" 1)"
+  [ ${#t[@]} -eq 2 ] || { echo "mpi_grayscale failed on $input"; exit 1; }
+  inner[$size mpi]=$(inner_count "${t[@]}")
+  echo "$size: ${inner[$size serial]} serial, ${inner[$size omp]} omp, ${inner[$size mpi]} mpi repetitions per sample"
+done
+
+# * samples are interleaved across sizes so a slow spell on a shared machine hits one sample per
+# stage rather than every sample of one size, best-of-N then skips it *
+for r in $(seq 1 "$reps"); do
+  for size in "${sizes[@]}"; do
+    input=${inputs[$size]}
+    read -r -a t <<< "$(sum_runs "${inner[$size serial]}" run_serial "$input")"
+    [ ${#t[@]} -eq 2 ] || { echo "grayscale failed on $input"; exit 1; }
+    samples[$size serial_compress]+=" ${t[0]}" samples[$size serial_grayscale]+=" ${t[1]}"
+
+    read -r -a t <<< "$(sum_runs "${inner[$size omp]}" run_omp "$input")"
+    [ ${#t[@]} -eq 2 ] || { echo "omp_grayscale failed on $input"; exit 1; }
+    samples[$size omp_compress]+=" ${t[0]}" samples[$size omp_total]+=" ${t[1]}"
+
+    read -r -a t <<< "$(run_mpi "$input" "${inner[$size mpi]}")"
+    [ ${#t[@]} -eq 2 ] || { echo "mpi_grayscale failed on $input"; exit 1; }
+    samples[$size mpi_compute]+=" ${t[0]}" samples[$size mpi_encode_pnm]+=" ${t[1]}"
+  done
+done
+
+for size in "${sizes[@]}"; do
+  IFS=x read -r width height channels <<< "$size"
+  bytes=$((width * height * channels))
+  {
+    echo "$size serial_compress $(best_mbps $((bytes * ${inner[$size serial]})) ${samples[$size serial_compress]})"
+    echo "$size serial_grayscale $(best_mbps $((bytes / 4 * ${inner[$size serial]})) ${samples[$size serial_grayscale]})"
+    echo "$size omp_compress $(best_mbps $((bytes * ${inner[$size omp]})) ${samples[$size omp_compress]})"
+    echo "$size omp_total $(best_mbps $((bytes * ${inner[$size omp]})) ${samples[$size omp_total]})"
+    echo "$size mpi_compute $(best_mbps $((bytes * ${inner[$size mpi]})) ${samples[$size mpi_compute]})"
+    echo "$size mpi_encode_pnm $(best_mbps $((bytes / 4 * ${inner[$size mpi]})) ${samples[$size mpi_encode_pnm]})"
+  } >> "$results"
+  rm -f "${inputs[$size]}"
+done
+rm -f out_c.pnm out_g.pnm
+
+if [ "${UPDATE_BASELINE:-0}" = "1" ] || [ ! -f "$baselineFile" ]; then
+  {
+    echo "# size stage MB/s - $(hostname), $(date +%F), regenerate with: make perf-baseline"
+    echo "# config threads=$threads ranks=$procs"
+    cat "$results"
+  } > "$baselineFile"
+  echo "Wrote baseline $baselineFile"
+  cat "$results"
+  exit 0
+fi
+
+if [ "$threads" != "$baseThreads" ] || [ "$procs" != "$baseProcs" ]; then
+  echo "Not comparing: baseline is for ${baseThreads:-?} threads/${baseProcs:-?} ranks, this run used $threads/$procs"
+  echo "Rerun without PERF_THREADS/PERF_PROCS, or record this config with make perf-baseline"
+  cat "$results"
+  exit 0
+fi
+
+# * compare against the baseline, stages/sizes missing from it are reported but not failed *
+awk -v thr="$threshold" '
+  NR == FNR { if ($1 !~ /^#/) base[$1 " " $2] = $3; next }
+  {
+    key = $1 " " $2
+    if (!(key in base)) { printf "new  %-32s %10.2f MB/s\n", key, $3; next }
+    change = (base[key] > 0) ? 100 * ($3 - base[key]) / base[key] : 0
+    status = (change < -thr) ? "SLOW" : "ok  "
+    if (change < -thr) bad = 1
+    printf "%s %-32s %10.2f MB/s (baseline %10.2f, %+6.1f%%)\n", status, key, $3, base[key], change
+  }
+  END { if (bad) { printf "Throughput dropped more than %s%% against the baseline\n", thr; exit 1 } }
+' "$baselineFile" "$results"
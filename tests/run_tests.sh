@@ -0,0 +1,169 @@
+#!/bin/bash
+# Bit-exactness regression test: every case through the serial, OpenMP (1..N threads) and
+# MPI (1..N ranks, bands and tiles) paths, each output checked against tests/golden.txt.
+# Also runs mpi_grayscale with good and bad -c/-g output specs and checks the format it reports.
+#
+#   TEST_PROCS     highest thread/rank count to try (default 4)
+#   MPIEXEC        launcher (default mpiexec), MPIEXEC_FLAGS extra launcher flags
+#   UPDATE_GOLDEN  =1 rewrites golden.txt from the serial outputs, only after an intended kernel change
+
+
+
+testDir=$(cd "$(dirname "$0")" && pwd)
+rootDir=$(dirname "$testDir")
+outDir="$testDir/out/test"
+goldenFile="$testDir/golden.txt"
+
+maxProcs=${TEST_PROCS:-4}
+mpiexec=${MPIEXEC:-mpiexec}
+read -r -a mpiFlags <<< "${MPIEXEC_FLAGS:-}"
+
+# name width height channels seed
+cases=(
+  "tiny_3c 2 2 3 1"
+  "min_1c 3 3 1 2"
+  "odd_1c 33 17 1 3"
+  "odd_2c 31 9 2 4"
+  "odd_3c 101 81 3 5"
+  "odd_4c 21 15 4 6"
+  "vga_3c 640 479 3 7"
+  "square_1c 1001 999 1 8"
+  "wide_2c 4097 33 2 9"
+  "tall_3c 65 4099 3 10"
+  "mid_4c 257 129 4 11"
+)
+
+passed=0
+failed=0
+
+input_name() { # <name> <channels>
+  case $2 in
+    1) echo "$1.pgm" ;;
+    3) echo "$1.ppm" ;;
+    *) echo "$1.png" ;;
+  esac
+}
+
+# compares <dir>/<case>_c.pnm and _g.pnm for every case against the goldens
+check_outputs() { # <label> <dir>
+  local label=$1 dir=$2 bad=0
+  for c in "${cases[@]}"; do
+    read -r name width height channels seed <<< "$c"
+    for out in "${name}_c.pnm" "${name}_g.pnm"; do
+      want=$(awk -v f="$out" '$2 == f { print $1 }' "$goldenFile")
+      got=$( [ -f "$dir/$out" ] && sha256sum < "$dir/$out" | cut -d' ' -f1 )
+      if [ -z "$want" ] || [ "$got" != "$want" ]; then
+        echo "FAIL $label: $out ${got:-missing} != ${want:-no golden}"
+        bad=1
+      fi
+    done
+  done
+  if [ $bad -eq 0 ]; then
+    passed=$((passed + 1))
+    echo "ok   $label"
+  else
+    failed=$((failed + 1))
+  fi
+}
+
+rm -rf "$outDir"
+mkdir -p "$outDir/inputs"
+cd "$outDir" || exit 1
+
+for c in "${cases[@]}"; do
+  read -r name width height channels seed <<< "$c"
+  "$testDir/gen_image" "$width" "$height" "$channels" "$seed" "inputs/$(input_name "$name" "$channels")" || exit 1
+done
+
+# * serial *
+mkdir -p serial
+for c in "${cases[@]}"; do
+  read -r name width height channels seed <<< "$c"
+  "$rootDir/grayscale" 1 "inputs/$(input_name "$name" "$channels")" "serial/${name}_c.pnm" "serial/${name}_g.pnm" >> serial/log.txt 2>&1
+done
+if [ "${UPDATE_GOLDEN:-0}" = "1" ]; then
+  (cd serial && sha256sum -- *_c.pnm *_g.pnm) > "$goldenFile"
+  echo "Rewrote $goldenFile from the serial path"
+fi
+check_outputs "serial" serial
+
+# * OpenMP, 1..N threads *
+for n in $(seq 1 "$maxProcs"); do
+  dir="omp_$n"
+  mkdir -p "$dir"
+  for c in "${cases[@]}"; do
+    read -r name width height channels seed <<< "$c"
+    "$rootDir/omp_grayscale" "$n" "inputs/$(input_name "$name" "$channels")" "$dir/${name}_c.pnm" "$dir/${name}_g.pnm" >> "$dir/log.txt" 2>&1
+  done
+  check_outputs "omp $n threads" "$dir"
+done
+
+# * MPI, 1..N ranks, all cases through one pipelined run *
+# default threshold, one row per rank, and one row/column tiles
+mpiModes=("" "-m 1" "-m 1 -t")
+for n in $(seq 1 "$maxProcs"); do
+  for m in "${!mpiModes[@]}"; do
+    dir="mpi_${n}_$m"
+    mkdir -p "$dir"
+    jobs=()
+    for c in "${cases[@]}"; do
+      read -r name width height channels seed <<< "$c"
+      jobs+=("inputs/$(input_name "$name" "$channels")" "$dir/${name}_c.pnm" "$dir/${name}_g.pnm")
+    done
+    read -r -a modeFlags <<< "${mpiModes[$m]}"
+    "$mpiexec" "${mpiFlags[@]}" -n "$n" "$rootDir/mpi_grayscale" "${modeFlags[@]}" "${jobs[@]}" > "$dir/log.txt" 2>&1
+    check_outputs "mpi $n ranks ${mpiModes[$m]:-default}" "$dir"
+  done
+done
+
+# * output specs: presets, <fmt>:<quality> bounds and formats picked from the destination name *
+# flags|compressed dest|grayscale dest|[fmt:q] expected for each, or "reject" if the run must fail
+specs=(
+  "-c best -g raw|c.jpg|g.pnm|jpg:100|pnm"
+  "-c high -g balanced|c.pnm|g.pnm|jpg:95|jpg:85"
+  "-c fast -g png|c.out|g.out|jpg:75|png:8"
+  "-c png-fast -g PNG:0|c|g|png:1|png:0"
+  "-c jpg:1 -g jpeg:100|c|g|jpg:1|jpg:100"
+  "-c bmp -g pnm|c.jpg|g.jpg|bmp|pnm"
+  "-c png:9|c.jpg|g.pgm|png:9|pnm"
+  "|c.jpeg|g.JPG|jpg|jpg"
+  "|c.png|g.bmp|png|bmp"
+  "|c_noext|g_noext|pnm|pnm"
+  "-c jpg:|c.jpg|g.jpg|reject"
+  "-c jpg:0|c.jpg|g.jpg|reject"
+  "-c jpg:101|c.jpg|g.jpg|reject"
+  "-g png:10|c.png|g.png|reject"
+  "-g png:-1|c.png|g.png|reject"
+  "-c jpg:9x|c.jpg|g.jpg|reject"
+  "-c pnm:|c.pnm|g.pnm|reject"
+  "-c :5|c.jpg|g.jpg|reject"
+  "-c gif|c.jpg|g.jpg|reject"
+)
+mkdir -p specs
+for i in "${!specs[@]}"; do
+  IFS='|' read -r flags cDest gDest wantC wantG <<< "${specs[$i]}"
+  read -r -a specFlags <<< "$flags"
+  label="spec ${flags:-<none>} -> $cDest $gDest"
+  cOut="specs/${i}_$cDest" gOut="specs/${i}_$gDest"
+  "$mpiexec" "${mpiFlags[@]}" -n 1 "$rootDir/mpi_grayscale" "${specFlags[@]}" inputs/odd_3c.ppm "$cOut" "$gOut" > "specs/$i.log" 2>&1
+  status=$?
+  if [ "$wantC" = "reject" ]; then
+    if [ $status -ne 0 ] && grep -q "^Bad output spec" "specs/$i.log"; then
+      passed=$((passed + 1))
+      echo "ok   $label rejected"
+    else
+      failed=$((failed + 1))
+      echo "FAIL $label: exit $status, expected a bad output spec error"
+    fi
+  elif [ $status -eq 0 ] && [ -s "$cOut" ] && [ -s "$gOut" ] &&
+    grep -qF "Compressed: $cOut [$wantC]" "specs/$i.log" && grep -qF "Grayscale: $gOut [$wantG]" "specs/$i.log"; then
+    passed=$((passed + 1))
+    echo "ok   $label [$wantC] [$wantG]"
+  else
+    failed=$((failed + 1))
+    echo "FAIL $label: exit $status, expected [$wantC] [$wantG], see $outDir/specs/$i.log"
+  fi
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
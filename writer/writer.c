@@ -0,0 +1,240 @@
+#include "writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "../stb/stb_image_write.h"
+
+#define DEFAULT_JPG_QUALITY 100
+#define DEFAULT_PNG_LEVEL 8
+
+// * Quality/throughput presets, slowest and largest first *
+// stb's baseline JPEG encoder always uses the precomputed standard Huffman tables and never
+// does an optimization pass, so the JPG rows only trade quantization (and, at <= 90, 4:2:0
+// chroma subsampling) against speed. "raw" skips entropy coding entirely.
+const output_preset_t output_presets[] = {
+    {"best", {JPG, 100}, "jpg q100, no chroma subsampling (old default)"},
+    {"high", {JPG, 95}, "jpg q95, no chroma subsampling"},
+    {"balanced", {JPG, 85}, "jpg q85, 4:2:0 subsampling, static huffman tables"},
+    {"fast", {JPG, 75}, "jpg q75, 4:2:0 subsampling, static huffman tables"},
+    {"png", {PNG, DEFAULT_PNG_LEVEL}, "lossless png, zlib level 8"},
+    {"png-fast", {PNG, 1}, "lossless png, zlib level 1"},
+    {"raw", {PNM, -1}, "uncompressed pgm/ppm (pam for 2/4 channels)"},
+};
+const int num_output_presets = sizeof(output_presets) / sizeof(output_presets[0]);
+
+typedef struct
+{
+  FILE *fp;
+  size_t bytes;
+  int shortWrite; // set once any fwrite comes up short, stb has no way to hear about it
+} write_ctx_t;
+
+static void counting_write(void *context, void *data, int size)
+{
+  write_ctx_t *ctx = (write_ctx_t *)context;
+  size_t written = fwrite(data, 1, size, ctx->fp);
+  ctx->bytes += written;
+  ctx->shortWrite |= (written != (size_t)size);
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+const char *filetype_name(filetype_t ftype)
+{
+  switch (ftype)
+  {
+  case PNG:
+    return "png";
+  case JPG:
+    return "jpg";
+  case BMP:
+    return "bmp";
+  case PNM:
+    return "pnm";
+  default:
+    return "unknown";
+  }
+}
+
+// * Guess format from extension, also accepts bare format names ("jpg", "pnm"...) *
+filetype_t filetype_from_name(const char *fileName)
+{
+  if (fileName == NULL)
+  {
+    return UNKNOWN_FILETYPE;
+  }
+  const char *dot = strrchr(fileName, '.');
+  const char *ext = (dot == NULL) ? fileName : dot + 1;
+
+  if (strcasecmp(ext, "png") == 0)
+  {
+    return PNG;
+  }
+  else if (strcasecmp(ext, "jpg") == 0 || strcasecmp(ext, "jpeg") == 0)
+  {
+    return JPG;
+  }
+  else if (strcasecmp(ext, "bmp") == 0)
+  {
+    return BMP;
+  }
+  else if (strcasecmp(ext, "pnm") == 0 || strcasecmp(ext, "pgm") == 0 || strcasecmp(ext, "ppm") == 0 || strcasecmp(ext, "pam") == 0)
+  {
+    return PNM;
+  }
+  return UNKNOWN_FILETYPE;
+}
+
+// * spec is either a preset name or <format>[:<quality>] *
+// returns 0 on success, -1 if spec is garbage (params is left untouched)
+int output_params_parse(const char *spec, output_params_t *params)
+{
+  for (int i = 0; i < num_output_presets; i++)
+  {
+    if (strcasecmp(spec, output_presets[i].name) == 0)
+    {
+      *params = output_presets[i].params;
+      return 0;
+    }
+  }
+
+  char fmt[16];
+  const char *colon = strchr(spec, ':');
+  size_t fmtLen = (colon == NULL) ? strlen(spec) : (size_t)(colon - spec);
+  if (fmtLen == 0 || fmtLen >= sizeof(fmt))
+  {
+    return -1;
+  }
+  memcpy(fmt, spec, fmtLen);
+  fmt[fmtLen] = '\0';
+
+  output_params_t parsed = {filetype_from_name(fmt), -1};
+  if (parsed.ftype == UNKNOWN_FILETYPE)
+  {
+    return -1;
+  }
+  if (colon != NULL)
+  {
+    char *end;
+    long q = strtol(colon + 1, &end, 10);
+    if (*end != '\0' || end == colon + 1)
+    {
+      return -1;
+    }
+    if ((parsed.ftype == JPG && (q < 1 || q > 100)) || (parsed.ftype == PNG && (q < 0 || q > 9)))
+    {
+      return -1;
+    }
+    parsed.quality = (int)q;
+  }
+  *params = parsed;
+  return 0;
+}
+
+void output_presets_print(FILE *fp)
+{
+  fprintf(fp, "Output presets:\n");
+  for (int i = 0; i < num_output_presets; i++)
+  {
+    fprintf(fp, "  %-10s %s\n", output_presets[i].name, output_presets[i].description);
+  }
+}
+
+// * netpbm: P5 for gray, P6 for rgb, P7 (pam) when there is an alpha channel *
+static int write_pnm(write_ctx_t *ctx, int width, int height, int channels, const uint8_t *data)
+{
+  int n;
+  char header[128];
+  if (channels == 1 || channels == 3)
+  {
+    n = snprintf(header, sizeof(header), "P%c\n%d %d\n255\n", (channels == 1) ? '5' : '6', width, height);
+  }
+  else if (channels == 2 || channels == 4)
+  {
+    n = snprintf(header, sizeof(header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+                 width, height, channels, (channels == 2) ? "GRAYSCALE_ALPHA" : "RGB_ALPHA");
+  }
+  else
+  {
+    return 0;
+  }
+  size_t dataSize = (size_t)width * height * channels;
+  ctx->bytes += fwrite(header, 1, n, ctx->fp);
+  ctx->bytes += fwrite(data, 1, dataSize, ctx->fp);
+  return ctx->bytes == (size_t)n + dataSize;
+}
+
+// * Encode + write one image, returns nonzero on success like the stbi_write_* functions *
+int write_image(const char *fileName, int width, int height, int channels, const uint8_t *data, output_params_t params, write_stats_t *stats)
+{
+  int ok = 0;
+  if (stats != NULL)
+  {
+    memset(stats, 0, sizeof(*stats));
+  }
+  write_ctx_t ctx = {fopen(fileName, "wb"), 0, 0};
+  if (ctx.fp == NULL)
+  {
+    return 0;
+  }
+
+  double start = now();
+  switch (params.ftype)
+  {
+  case PNG:
+    stbi_write_png_compression_level = (params.quality < 0) ? DEFAULT_PNG_LEVEL : params.quality;
+    ok = stbi_write_png_to_func(counting_write, &ctx, width, height, channels, data, 0);
+    stbi_write_png_compression_level = DEFAULT_PNG_LEVEL;
+    break;
+  case JPG:
+    ok = stbi_write_jpg_to_func(counting_write, &ctx, width, height, channels, data, (params.quality < 0) ? DEFAULT_JPG_QUALITY : params.quality);
+    break;
+  case BMP:
+    ok = stbi_write_bmp_to_func(counting_write, &ctx, width, height, channels, data);
+    break;
+  case PNM:
+    ok = write_pnm(&ctx, width, height, channels, data);
+    break;
+  default:
+    break;
+  }
+  if (fclose(ctx.fp) != 0 || ctx.shortWrite)
+  {
+    ok = 0;
+  }
+  double elapsed = now() - start;
+
+  if (stats != NULL)
+  {
+    stats->bytes = ctx.bytes;
+    stats->seconds = elapsed;
+    stats->mbps = (elapsed > 0) ? ((double)width * height * channels / (1024.0 * 1024.0)) / elapsed : 0.0;
+  }
+  return ok;
+}
+
+// * Format from the destination's extension, unknown extensions keep the old jpg q100 *
+int write_output(const char *fileName, int width, int height, int channels, const uint8_t *data)
+{
+  output_params_t params = {filetype_from_name(fileName), -1};
+  params.ftype = (params.ftype == UNKNOWN_FILETYPE) ? JPG : params.ftype;
+  return write_image(fileName, width, height, channels, data, params, NULL);
+}
+
+void write_stats_print(FILE *fp, const char *label, const char *fileName, output_params_t params, const write_stats_t *stats)
+{
+  fprintf(fp, "%s: %s [%s", label, fileName, filetype_name(params.ftype));
+  if (params.quality >= 0 && (params.ftype == JPG || params.ftype == PNG))
+  {
+    fprintf(fp, ":%d", params.quality);
+  }
+  fprintf(fp, "] %zu B in %f s (%.2f MB/s)\n", stats->bytes, stats->seconds, stats->mbps);
+}
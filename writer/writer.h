@@ -0,0 +1,53 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum filetype
+{
+  PNG,
+  JPG,
+  BMP,
+  PNM,
+  UNKNOWN_FILETYPE
+} filetype_t;
+
+// * Per-output encoder settings *
+// quality means 1-100 for JPG and the zlib level (0-9) for PNG, it is ignored for BMP/PNM.
+// A quality of -1 picks the format's default (JPG 100, PNG 8).
+typedef struct
+{
+  filetype_t ftype;
+  int quality;
+} output_params_t;
+
+typedef struct
+{
+  const char *name;
+  output_params_t params;
+  const char *description;
+} output_preset_t;
+
+// * What a single write cost us *
+typedef struct
+{
+  size_t bytes;   // bytes that actually hit the file
+  double seconds; // wall time spent encoding + writing
+  double mbps;    // raw pixel MB pushed through the encoder per second
+} write_stats_t;
+
+extern const output_preset_t output_presets[];
+extern const int num_output_presets;
+
+const char *filetype_name(filetype_t ftype);
+filetype_t filetype_from_name(const char *fileName);
+int output_params_parse(const char *spec, output_params_t *params);
+void output_presets_print(FILE *fp);
+
+int write_image(const char *fileName, int width, int height, int channels, const uint8_t *data, output_params_t params, write_stats_t *stats);
+int write_output(const char *fileName, int width, int height, int channels, const uint8_t *data);
+void write_stats_print(FILE *fp, const char *label, const char *fileName, output_params_t params, const write_stats_t *stats);
+
+#endif